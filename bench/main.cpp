@@ -0,0 +1,492 @@
+#include <CDG.h>
+#include <CueParser.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+enum {
+    SyntheticSeconds = 600,
+    FramesPerSecond = 25,
+    MinIterations = 3
+};
+
+struct Stream
+{
+    std::vector<uint8_t> subcode;
+    size_t sectors { 0 };
+};
+
+static CDG::Pack makePack(std::mt19937& rng)
+{
+    CDG::Pack pack { };
+    auto rnd = [&rng](uint32_t n) { return static_cast<uint32_t>(rng() % n); };
+
+    // mostly tile blocks, like real discs
+    const auto kind = rnd(1000);
+    if (kind < 100) {
+        // empty pack
+        return pack;
+    }
+    pack.command = CDG::GraphicsCommand;
+    if (kind < 110) {
+        pack.instruction = static_cast<uint8_t>(static_cast<uint32_t>(CDG::Instruction::LoadColorsLow) + rnd(2));
+    } else if (kind < 112) {
+        pack.instruction = static_cast<uint8_t>(CDG::Instruction::MemoryPreset);
+    } else if (kind < 113) {
+        pack.instruction = static_cast<uint8_t>(rnd(2) ? CDG::Instruction::ScrollCopy : CDG::Instruction::ScrollPreset);
+    } else {
+        pack.instruction = static_cast<uint8_t>(rnd(4) ? CDG::Instruction::TileBlock : CDG::Instruction::TileBlockXor);
+    }
+    for (auto& d : pack.data)
+        d = static_cast<uint8_t>(rnd(64));
+    if (pack.instruction == static_cast<uint8_t>(CDG::Instruction::TileBlock)
+        || pack.instruction == static_cast<uint8_t>(CDG::Instruction::TileBlockXor)) {
+        pack.data[2] = static_cast<uint8_t>(rnd(CDG::Screen::Rows));
+        pack.data[3] = static_cast<uint8_t>(rnd(CDG::Screen::Columns));
+    }
+    CDG::computeParity(pack);
+    return pack;
+}
+
+// scrambles and delays the packs the way they are written to disc, then lays
+// the symbols out as subcode, flipping a symbol in roughly errorRate packs
+static Stream makeStream(const std::vector<CDG::Pack>& packs, CDG::Layout layout, double errorRate, std::mt19937& rng)
+{
+    const size_t rawPacks = packs.size() + 7;
+    const size_t sectors = (rawPacks + CDG::PacksPerSector - 1) / CDG::PacksPerSector;
+    std::vector<uint8_t> symbols(sectors * CDG::SubcodeSize);
+
+    for (size_t n = 0; n < packs.size(); ++n) {
+        uint8_t s[CDG::PackSize];
+        memcpy(s, &packs[n], CDG::PackSize);
+        std::swap(s[1], s[18]);
+        std::swap(s[2], s[5]);
+        std::swap(s[3], s[23]);
+        for (size_t i = 0; i < CDG::PackSize; ++i)
+            symbols[(n + i % 8) * CDG::PackSize + i] = s[i];
+    }
+
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for (size_t p = 0; p < rawPacks; ++p) {
+        if (dist(rng) < errorRate)
+            symbols[p * CDG::PackSize + rng() % CDG::PackSize] ^= 1 + rng() % 63;
+    }
+
+    Stream out;
+    out.sectors = sectors;
+    out.subcode.resize(symbols.size());
+    if (layout == CDG::Layout::Interleaved) {
+        out.subcode = symbols;
+        return out;
+    }
+    for (size_t sector = 0; sector < sectors; ++sector) {
+        const uint8_t* src = symbols.data() + sector * CDG::SubcodeSize;
+        uint8_t* dst = out.subcode.data() + sector * CDG::SubcodeSize;
+        for (size_t c = 0; c < 8; ++c) {
+            for (size_t g = 0; g < 12; ++g) {
+                uint8_t byte = 0;
+                for (size_t b = 0; b < 8; ++b)
+                    byte |= ((src[g * 8 + b] >> (7 - c)) & 1) << (7 - b);
+                dst[c * 12 + g] = byte;
+            }
+        }
+    }
+    return out;
+}
+
+enum class Work {
+    Packs,
+    Append,
+    Screen,
+    Frames
+};
+
+static const char* workName(Work work)
+{
+    switch (work) {
+    case Work::Packs:
+        return "packs";
+    case Work::Append:
+        return "packs, appended";
+    case Work::Screen:
+        return "packs+screen";
+    case Work::Frames:
+        return "packs+screen+frames";
+    }
+    return "";
+}
+
+static void run(const Stream& stream, const CDG::Options& options, Work work)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<CDG::Pack> packs;
+    std::vector<uint32_t> frame(CDG::Screen::Width * CDG::Screen::Height);
+    const size_t sectorsPerFrame = CDG::SectorsPerSecond / FramesPerSecond;
+
+    size_t iterations = 0;
+    CDG::Stats stats;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration { };
+    while (iterations < MinIterations || elapsed < std::chrono::seconds(1)) {
+        CDG::Decoder decoder(options);
+        CDG::Screen screen;
+        if (work == Work::Append) {
+            // one sector per call into a single vector, like a streaming caller
+            packs.clear();
+            for (size_t sector = 0; sector < stream.sectors; ++sector)
+                decoder.decode(stream.subcode.data() + sector * CDG::SubcodeSize, 1, packs);
+            stats = decoder.stats();
+            ++iterations;
+            elapsed = Clock::now() - start;
+            continue;
+        }
+        for (size_t sector = 0; sector < stream.sectors; sector += sectorsPerFrame) {
+            const size_t count = std::min(sectorsPerFrame, stream.sectors - sector);
+            packs.clear();
+            decoder.decode(stream.subcode.data() + sector * CDG::SubcodeSize, count, packs);
+            if (work == Work::Packs)
+                continue;
+            bool changed = false;
+            for (const auto& pack : packs)
+                changed |= screen.apply(pack);
+            if (work == Work::Frames && changed)
+                screen.render(frame.data());
+        }
+        stats = decoder.stats();
+        ++iterations;
+        elapsed = Clock::now() - start;
+    }
+
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    const double sectorsPerSecond = static_cast<double>(stream.sectors) * iterations / seconds;
+    printf("  %-20s %12.0f sectors/s %8.1f MB/s subcode %8.0f streams/core\n",
+           workName(work), sectorsPerSecond,
+           sectorsPerSecond * CDG::SubcodeSize / (1024.0 * 1024.0),
+           sectorsPerSecond / CDG::SectorsPerSecond);
+    if (work == Work::Packs) {
+        printf("  %-20s %12llu packs, %llu corrected, %llu uncorrectable\n", "",
+               static_cast<unsigned long long>(stats.packs),
+               static_cast<unsigned long long>(stats.corrected),
+               static_cast<unsigned long long>(stats.uncorrectable));
+    }
+}
+
+static void runAll(const Stream& stream, const CDG::Options& options)
+{
+    for (auto work : { Work::Packs, Work::Append, Work::Screen, Work::Frames })
+        run(stream, options, work);
+}
+
+static bool verify(const std::vector<CDG::Pack>& expected, const Stream& stream, CDG::Layout layout, bool append)
+{
+    CDG::Options options;
+    options.layout = layout;
+    CDG::Decoder decoder(options);
+    std::vector<CDG::Pack> packs;
+    if (append) {
+        for (size_t sector = 0; sector < stream.sectors; ++sector)
+            decoder.decode(stream.subcode.data() + sector * CDG::SubcodeSize, 1, packs);
+    } else {
+        decoder.decode(stream.subcode.data(), stream.sectors, packs);
+    }
+    if (packs.size() < expected.size())
+        return false;
+    return !memcmp(packs.data(), expected.data(), expected.size() * sizeof(CDG::Pack));
+}
+
+// packs that each carry their index, so a miscorrected pack can't match another one
+static std::vector<CDG::Pack> uniquePacks(size_t count, std::mt19937& rng)
+{
+    std::vector<CDG::Pack> packs(count);
+    for (size_t i = 0; i < count; ++i) {
+        packs[i] = makePack(rng);
+        packs[i].data[13] = static_cast<uint8_t>(i & 0x3f);
+        packs[i].data[14] = static_cast<uint8_t>((i >> 6) & 0x3f);
+        packs[i].data[15] = static_cast<uint8_t>((i >> 12) & 0x3f);
+        CDG::computeParity(packs[i]);
+    }
+    return packs;
+}
+
+// every decoded pack has to match the input in order, the only packs allowed
+// to be missing are the ones counted as uncorrectable, if any are allowed
+static bool verifyDamaged(const std::vector<CDG::Pack>& expected, const Stream& stream, const CDG::Options& options, bool allowDrops)
+{
+    CDG::Decoder decoder(options);
+    std::vector<CDG::Pack> packs;
+    decoder.decode(stream.subcode.data(), stream.sectors, packs);
+
+    size_t next = 0;
+    size_t missing = 0;
+    for (const auto& pack : packs) {
+        while (next < expected.size() && memcmp(&pack, &expected[next], sizeof(CDG::Pack))) {
+            ++next;
+            ++missing;
+        }
+        if (next == expected.size())
+            return false;
+        ++next;
+    }
+    missing += expected.size() - next;
+
+    const auto& stats = decoder.stats();
+    printf("  %-20s %12llu packs, %llu corrected, %llu uncorrectable\n", "verified",
+           static_cast<unsigned long long>(stats.packs),
+           static_cast<unsigned long long>(stats.corrected),
+           static_cast<unsigned long long>(stats.uncorrectable));
+    if (!allowDrops && stats.uncorrectable)
+        return false;
+    return stats.packs == expected.size() && missing == stats.uncorrectable;
+}
+
+// two errors in every pack, half of them both in the command, instruction and Q
+// parity, written straight to subcode without the disc interleave
+static Stream twoErrorStream(const std::vector<CDG::Pack>& packs, std::mt19937& rng)
+{
+    Stream out;
+    out.sectors = packs.size() / CDG::PacksPerSector;
+    out.subcode.resize(out.sectors * CDG::SubcodeSize);
+    for (size_t n = 0; n < out.sectors * CDG::PacksPerSector; ++n) {
+        uint8_t* s = out.subcode.data() + n * CDG::PackSize;
+        memcpy(s, &packs[n], CDG::PackSize);
+        const size_t range = n & 1 ? 4 : CDG::PackSize;
+        const size_t first = rng() % range;
+        const size_t second = (first + 1 + rng() % (range - 1)) % range;
+        s[first] ^= 1 + rng() % 63;
+        s[second] ^= 1 + rng() % 63;
+    }
+    return out;
+}
+
+static int checkCorrection(std::mt19937& rng)
+{
+    // packs + 7 fills whole sectors so every input pack leaves the delay line
+    const auto packs = uniquePacks(20001, rng);
+
+    for (auto layout : { CDG::Layout::Interleaved, CDG::Layout::PerChannel }) {
+        const char* name = layout == CDG::Layout::Interleaved ? "interleaved" : "per channel";
+        CDG::Options options;
+        options.layout = layout;
+        for (double rate : { 0.05, 0.2 }) {
+            printf("%s, %.0f%% of packs damaged\n", name, rate * 100);
+            if (!verifyDamaged(packs, makeStream(packs, layout, rate, rng), options, true)) {
+                fprintf(stderr, "%s: corrected packs don't match\n", name);
+                return 1;
+            }
+        }
+    }
+
+    CDG::Options options;
+    options.deinterleave = false;
+    const std::vector<CDG::Pack> whole(packs.begin(), packs.end() - 1);
+    printf("two errors per pack\n");
+    if (!verifyDamaged(whole, twoErrorStream(whole, rng), options, false)) {
+        fprintf(stderr, "two errors per pack: packs miscorrected or dropped\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static CDG::Pack graphicsPack(CDG::Instruction instruction, std::initializer_list<uint8_t> data)
+{
+    CDG::Pack pack { };
+    pack.command = CDG::GraphicsCommand;
+    pack.instruction = static_cast<uint8_t>(instruction);
+    std::copy(data.begin(), data.end(), pack.data);
+    return pack;
+}
+
+static CDG::Pack solidTile(uint8_t color, uint8_t row, uint8_t column)
+{
+    return graphicsPack(CDG::Instruction::TileBlock, {
+        0, color, row, column, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f
+    });
+}
+
+// a blank screen with color 9 in the top left tile and 10 in the bottom right one
+static void scrollScreen(CDG::Screen& screen)
+{
+    screen.reset();
+    screen.apply(solidTile(9, 0, 0));
+    screen.apply(solidTile(10, CDG::Screen::Rows - 1, CDG::Screen::Columns - 1));
+}
+
+static int checkScreen()
+{
+    enum { W = CDG::Screen::Width, H = CDG::Screen::Height };
+
+    size_t failures = 0;
+    auto check = [&failures](bool ok, const char* what) {
+        if (!ok) {
+            fprintf(stderr, "screen: %s\n", what);
+            ++failures;
+        }
+    };
+
+    CDG::Screen screen;
+
+    const auto tile = graphicsPack(CDG::Instruction::TileBlock, {
+        3, 5, 2, 4, 0x20, 0x01, 0x3f, 0x00, 0x15, 0x2a, 0x20, 0x01, 0x3f, 0x00, 0x15, 0x2a
+    });
+    check(screen.apply(tile), "tile block reported no change");
+    check(!screen.apply(tile), "repeated tile block reported a change");
+    bool tileok = true;
+    for (uint32_t y = 0; y < CDG::Screen::TileHeight; ++y) {
+        for (uint32_t x = 0; x < CDG::Screen::TileWidth; ++x) {
+            const uint8_t expected = (tile.data[4 + y] >> (5 - x)) & 1 ? 5 : 3;
+            tileok &= screen.pixel(4 * CDG::Screen::TileWidth + x, 2 * CDG::Screen::TileHeight + y) == expected;
+        }
+    }
+    check(tileok, "tile block pixels");
+
+    auto before = screen;
+    auto xorTile = tile;
+    xorTile.instruction = static_cast<uint8_t>(CDG::Instruction::TileBlockXor);
+    xorTile.data[0] = 6;
+    check(screen.apply(xorTile), "xor tile block reported no change");
+    screen.apply(xorTile);
+    bool restored = true;
+    for (uint32_t y = 0; y < H; ++y) {
+        for (uint32_t x = 0; x < W; ++x)
+            restored &= screen.pixel(x, y) == before.pixel(x, y);
+    }
+    check(restored, "xor tile block applied twice didn't restore the pixels");
+
+    const auto preset = graphicsPack(CDG::Instruction::MemoryPreset, { 7, 0 });
+    check(screen.apply(preset), "memory preset reported no change");
+    auto repeat = graphicsPack(CDG::Instruction::MemoryPreset, { 7, 1 });
+    check(!screen.apply(repeat), "repeated memory preset reported a change");
+    check(!screen.apply(solidTile(1, CDG::Screen::Rows, 0)), "tile block below the screen reported a change");
+    check(!screen.apply(solidTile(1, 0, CDG::Screen::Columns)), "tile block right of the screen reported a change");
+    check(screen.pixel(0, 0) == 7 && screen.pixel(W - 1, H - 1) == 7, "out of range tile block drew");
+
+    // scroll instructions, h and v are the command in bits 4-5 and no offset
+    struct Scroll {
+        const char* what;
+        CDG::Instruction instruction;
+        uint8_t h, v;
+        uint32_t x, y;
+        uint8_t expected;
+    };
+    const auto P = CDG::Instruction::ScrollPreset;
+    const auto C = CDG::Instruction::ScrollCopy;
+    const Scroll scrolls[] = {
+        { "preset right moves", P, 0x10, 0, 6, 0, 9 },
+        { "preset right fills", P, 0x10, 0, 0, H - 1, 4 },
+        { "copy right moves", C, 0x10, 0, 6, 0, 9 },
+        { "copy right wraps", C, 0x10, 0, 0, H - 1, 10 },
+        { "preset left moves", P, 0x20, 0, W - 12, H - 1, 10 },
+        { "preset left fills", P, 0x20, 0, W - 1, 0, 4 },
+        { "copy left wraps", C, 0x20, 0, W - 1, 0, 9 },
+        { "preset down moves", P, 0, 0x10, 0, 12, 9 },
+        { "preset down fills", P, 0, 0x10, W - 1, 0, 4 },
+        { "copy down wraps", C, 0, 0x10, W - 1, 0, 10 },
+        { "preset up moves", P, 0, 0x20, W - 1, H - 24, 10 },
+        { "preset up fills", P, 0, 0x20, 0, H - 1, 4 },
+        { "copy up wraps", C, 0, 0x20, 0, H - 1, 9 }
+    };
+    for (const auto& scroll : scrolls) {
+        scrollScreen(screen);
+        check(screen.apply(graphicsPack(scroll.instruction, { 4, scroll.h, scroll.v })), scroll.what);
+        check(screen.pixel(scroll.x, scroll.y) == scroll.expected, scroll.what);
+    }
+    scrollScreen(screen);
+    check(!screen.apply(graphicsPack(P, { 4, 0, 0 })), "scroll without movement reported a change");
+
+    // 4 bits each of red, green and blue spread over two six bit symbols
+    auto colors = graphicsPack(CDG::Instruction::LoadColorsLow, { });
+    auto highColors = graphicsPack(CDG::Instruction::LoadColorsHigh, { });
+    uint16_t expected[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        const uint8_t r = static_cast<uint8_t>(i);
+        const uint8_t g = static_cast<uint8_t>(15 - i);
+        const uint8_t b = static_cast<uint8_t>((i * 7) & 0x0f);
+        auto& pack = i < 8 ? colors : highColors;
+        pack.data[(i % 8) * 2] = static_cast<uint8_t>((r << 2) | (g >> 2));
+        pack.data[(i % 8) * 2 + 1] = static_cast<uint8_t>(((g & 0x03) << 4) | b);
+        expected[i] = static_cast<uint16_t>((r << 8) | (g << 4) | b);
+    }
+    screen.reset();
+    check(screen.apply(colors) && screen.apply(highColors), "loading colors reported no change");
+    check(!screen.apply(colors), "reloading the same colors reported a change");
+    check(std::equal(expected, expected + 16, screen.palette().begin()), "palette entries");
+
+    std::vector<uint32_t> frame(W * H);
+    screen.apply(graphicsPack(CDG::Instruction::MemoryPreset, { 2, 0 }));
+    screen.render(frame.data());
+    check(frame[H / 2 * W + W / 2] == 0xff22ddee, "rendered pixel color");
+
+    printf("screen checks, %zu failed\n", failures);
+    return failures ? 1 : 0;
+}
+
+static int synthetic()
+{
+    std::mt19937 rng(0xcd6);
+
+    std::vector<CDG::Pack> packs(SyntheticSeconds * CDG::SectorsPerSecond * CDG::PacksPerSector);
+    for (auto& pack : packs)
+        pack = makePack(rng);
+
+    if (checkCorrection(rng) || checkScreen())
+        return 1;
+
+    printf("synthetic stream, %u s, %zu packs\n", SyntheticSeconds, packs.size());
+
+    for (auto layout : { CDG::Layout::Interleaved, CDG::Layout::PerChannel }) {
+        const char* name = layout == CDG::Layout::Interleaved ? "interleaved" : "per channel";
+
+        const auto clean = makeStream(packs, layout, 0.0, rng);
+        if (!verify(packs, clean, layout, false) || !verify(packs, clean, layout, true)) {
+            fprintf(stderr, "%s: decoded packs don't match\n", name);
+            return 1;
+        }
+
+        CDG::Options options;
+        options.layout = layout;
+        printf("%s, clean\n", name);
+        runAll(clean, options);
+
+        const auto noisy = makeStream(packs, layout, 0.05, rng);
+        printf("%s, 5%% of packs damaged\n", name);
+        runAll(noisy, options);
+    }
+
+    return 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+#ifndef NDEBUG
+    printf("warning: assertions enabled, build with CMAKE_BUILD_TYPE=Release for meaningful numbers\n");
+#endif
+
+    if (argc == 1)
+        return synthetic();
+
+    const auto sheet = CueParser::parseFile(argv[1]);
+    for (const auto& track : CDG::tracks(sheet, argv[1])) {
+        CDG::Reader reader(track);
+        if (!reader.isOpen()) {
+            fprintf(stderr, "unable to open '%s'\n", track.filename.c_str());
+            continue;
+        }
+        Stream stream;
+        stream.subcode.resize(reader.sectors() * CDG::SubcodeSize);
+        stream.sectors = reader.read(stream.subcode.data(), reader.sectors());
+
+        printf("track %u, %llu sectors\n", track.number, static_cast<unsigned long long>(stream.sectors));
+        runAll(stream, CDG::Options { });
+    }
+
+    return 0;
+}
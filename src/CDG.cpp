@@ -0,0 +1,688 @@
+#include "CDG.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CDG_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define CDG_NEON
+#include <arm_neon.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum {
+    ParityQ = 2,
+    ParityP = 4,
+    InnerLeft = 6,
+    InnerTop = 12,
+    InnerRight = CDG::Screen::Width - 6,
+    InnerBottom = CDG::Screen::Height - 12
+};
+
+enum class Result {
+    Clean,
+    Corrected,
+    Uncorrectable
+};
+
+// GF(64) with x^6 + x + 1, the field used by the R-W parity
+struct Tables
+{
+    Tables();
+
+    uint8_t mul(uint8_t a, uint8_t b) const;
+    uint8_t div(uint8_t a, uint8_t b) const;
+
+    uint8_t exp[126];
+    uint8_t log[64];
+    uint8_t genQ[ParityQ];
+    uint8_t genP[ParityP];
+
+    // contribution of each symbol value at each position to the
+    // P syndromes (bytes 0-3) and the Q syndromes (bytes 4-5)
+    uint64_t syndrome[CDG::PackSize][64];
+
+    // selects the symbols that were delayed by n packs
+    uint64_t delayMask[8];
+
+    // 0xff for each set pixel of a six pixel tile row
+    uint64_t tileMask[64];
+};
+
+inline uint8_t Tables::mul(uint8_t a, uint8_t b) const
+{
+    if (!a || !b)
+        return 0;
+    return exp[log[a] + log[b]];
+}
+
+inline uint8_t Tables::div(uint8_t a, uint8_t b) const
+{
+    if (!a)
+        return 0;
+    return exp[log[a] + 63 - log[b]];
+}
+
+static void generator(const Tables& tables, uint8_t* gen, size_t parity)
+{
+    // (x + 1)(x + a)(x + a^2)... lowest coefficient first, the leading 1 is implied
+    uint8_t poly[ParityP + 1] = { 1 };
+    for (size_t j = 0; j < parity; ++j) {
+        const uint8_t root = tables.exp[j];
+        for (size_t k = j + 1; k > 0; --k)
+            poly[k] = poly[k - 1] ^ tables.mul(poly[k], root);
+        poly[0] = tables.mul(poly[0], root);
+    }
+    memcpy(gen, poly, parity);
+}
+
+Tables::Tables()
+{
+    uint8_t x = 1;
+    for (size_t i = 0; i < 63; ++i) {
+        exp[i] = exp[i + 63] = x;
+        log[x] = static_cast<uint8_t>(i);
+        x <<= 1;
+        if (x & 0x40)
+            x ^= 0x43;
+    }
+    log[0] = 0;
+
+    generator(*this, genQ, ParityQ);
+    generator(*this, genP, ParityP);
+
+    for (size_t i = 0; i < CDG::PackSize; ++i) {
+        for (uint8_t s = 0; s < 64; ++s) {
+            uint64_t syn = 0;
+            for (size_t j = 0; j < ParityP; ++j)
+                syn |= static_cast<uint64_t>(mul(s, exp[(j * (CDG::PackSize - 1 - i)) % 63])) << (j * 8);
+            if (i < 4) {
+                for (size_t j = 0; j < ParityQ; ++j)
+                    syn |= static_cast<uint64_t>(mul(s, exp[(j * (3 - i)) % 63])) << ((4 + j) * 8);
+            }
+            syndrome[i][s] = syn;
+        }
+    }
+
+    for (size_t d = 0; d < 8; ++d) {
+        uint8_t bytes[8] = { };
+        bytes[d] = 0xff;
+        memcpy(&delayMask[d], bytes, sizeof(bytes));
+    }
+
+    for (uint8_t bits = 0; bits < 64; ++bits) {
+        uint8_t bytes[8] = { };
+        for (size_t px = 0; px < CDG::Screen::TileWidth; ++px)
+            bytes[px] = (bits >> (5 - px)) & 1 ? 0xff : 0x00;
+        memcpy(&tileMask[bits], bytes, sizeof(bytes));
+    }
+}
+
+const Tables tables;
+
+// returns true if any of the pixels had a different color
+static inline bool fill(uint8_t* pixels, size_t count, uint8_t color)
+{
+    const bool changed = std::any_of(pixels, pixels + count, [color](uint8_t p) { return p != color; });
+    if (changed)
+        memset(pixels, color, count);
+    return changed;
+}
+
+static inline void encode(uint8_t* symbols, size_t count, const uint8_t* gen, size_t parity)
+{
+    // systematic encoding, the parity is the remainder of the message divided by the generator
+    uint8_t rem[ParityP] = { };
+    for (size_t i = 0; i < count - parity; ++i) {
+        const uint8_t feedback = symbols[i] ^ rem[parity - 1];
+        for (size_t k = parity - 1; k > 0; --k)
+            rem[k] = rem[k - 1] ^ tables.mul(feedback, gen[k]);
+        rem[0] = tables.mul(feedback, gen[0]);
+    }
+    for (size_t j = 0; j < parity; ++j)
+        symbols[count - parity + j] = rem[parity - 1 - j];
+}
+
+static inline Result correct(uint8_t* symbols)
+{
+    uint64_t syn = 0;
+    for (size_t i = 0; i < CDG::PackSize; ++i)
+        syn ^= tables.syndrome[i][symbols[i]];
+    if (!syn)
+        return Result::Clean;
+
+    // the syndrome tables are linear so fixing a symbol can be folded straight into syn
+    auto fix = [symbols, &syn](size_t pos, uint8_t error) {
+        symbols[pos] ^= error;
+        syn ^= tables.syndrome[pos][error];
+    };
+
+    // P covers all symbols and corrects up to two errors anywhere, Q is only
+    // used as a final check since a single error guess from Q can be wrong
+    // when two errors fall in the first four symbols
+    const uint8_t s0 = syn & 0xff;
+    const uint8_t s1 = (syn >> 8) & 0xff;
+    const uint8_t s2 = (syn >> 16) & 0xff;
+    const uint8_t s3 = (syn >> 24) & 0xff;
+    if (!(s0 | s1 | s2 | s3))
+        return syn ? Result::Uncorrectable : Result::Corrected;
+
+    // single error, x is the error locator
+    if (s0 && s1) {
+        const uint8_t x = tables.div(s1, s0);
+        const auto l = tables.log[x];
+        if (l < CDG::PackSize && tables.mul(s1, x) == s2 && tables.mul(s2, x) == s3) {
+            fix(CDG::PackSize - 1 - l, s0);
+            return syn ? Result::Uncorrectable : Result::Corrected;
+        }
+    }
+
+    // two errors, solve for the locator polynomial x^2 + sigma1 x + sigma2
+    const uint8_t det = tables.mul(s1, s1) ^ tables.mul(s0, s2);
+    if (!det)
+        return Result::Uncorrectable;
+    const uint8_t sigma1 = tables.div(tables.mul(s0, s3) ^ tables.mul(s1, s2), det);
+    const uint8_t sigma2 = tables.div(tables.mul(s2, s2) ^ tables.mul(s1, s3), det);
+
+    uint8_t roots[2];
+    size_t numRoots = 0;
+    for (size_t l = 0; l < CDG::PackSize; ++l) {
+        const uint8_t x = tables.exp[l];
+        if ((tables.mul(x, x) ^ tables.mul(sigma1, x) ^ sigma2) != 0)
+            continue;
+        if (numRoots == 2)
+            return Result::Uncorrectable;
+        roots[numRoots++] = static_cast<uint8_t>(l);
+    }
+    if (numRoots != 2)
+        return Result::Uncorrectable;
+
+    const uint8_t x1 = tables.exp[roots[0]];
+    const uint8_t x2 = tables.exp[roots[1]];
+    const uint8_t e1 = tables.div(s1 ^ tables.mul(s0, x2), x1 ^ x2);
+    fix(CDG::PackSize - 1 - roots[0], e1);
+    fix(CDG::PackSize - 1 - roots[1], s0 ^ e1);
+    return syn ? Result::Uncorrectable : Result::Corrected;
+}
+
+static inline void extractInterleaved(const uint8_t* subcode, uint8_t* symbols)
+{
+    for (size_t i = 0; i < CDG::SubcodeSize; ++i)
+        symbols[i] = subcode[i] & 0x3f;
+}
+
+// The per channel layout stores each channel as a 96 bit stream so getting at the
+// symbols is an 8x8 bit matrix transpose for every 8 symbols. The SIMD versions
+// expand two channel bytes to 16 lanes, test one bit per lane and merge the
+// result into the symbol bit for that channel.
+#if defined(CDG_SSE2)
+static inline void extractPerChannel(const uint8_t* subcode, uint8_t* symbols)
+{
+    const __m128i bits = _mm_set1_epi64x(0x0102040810204080LL);
+    for (size_t q = 0; q < CDG::SubcodeSize / 16; ++q) {
+        __m128i acc = _mm_setzero_si128();
+        for (size_t c = 2; c < 8; ++c) {
+            const uint8_t* src = subcode + c * 12 + q * 2;
+            __m128i x = _mm_cvtsi32_si128(src[0] | (src[1] << 8));
+            x = _mm_unpacklo_epi8(x, x);
+            x = _mm_unpacklo_epi16(x, x);
+            x = _mm_unpacklo_epi32(x, x);
+            x = _mm_cmpeq_epi8(_mm_and_si128(x, bits), bits);
+            acc = _mm_or_si128(acc, _mm_and_si128(x, _mm_set1_epi8(static_cast<char>(1 << (7 - c)))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(symbols + q * 16), acc);
+    }
+}
+#elif defined(CDG_NEON)
+static inline void extractPerChannel(const uint8_t* subcode, uint8_t* symbols)
+{
+    static const uint8_t bitValues[16] = {
+        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+    };
+    const uint8x16_t bits = vld1q_u8(bitValues);
+    for (size_t q = 0; q < CDG::SubcodeSize / 16; ++q) {
+        uint8x16_t acc = vdupq_n_u8(0);
+        for (size_t c = 2; c < 8; ++c) {
+            const uint8_t* src = subcode + c * 12 + q * 2;
+            const uint8x16_t x = vcombine_u8(vdup_n_u8(src[0]), vdup_n_u8(src[1]));
+            acc = vorrq_u8(acc, vandq_u8(vtstq_u8(x, bits), vdupq_n_u8(1 << (7 - c))));
+        }
+        vst1q_u8(symbols + q * 16, acc);
+    }
+}
+#else
+static inline void extractPerChannel(const uint8_t* subcode, uint8_t* symbols)
+{
+    for (size_t g = 0; g < CDG::SubcodeSize / 8; ++g) {
+        // row c of the matrix is channel c, P in the most significant byte
+        uint64_t x = 0;
+        for (size_t c = 0; c < 8; ++c)
+            x = (x << 8) | subcode[c * 12 + g];
+        uint64_t t;
+        t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+        x ^= t ^ (t << 7);
+        t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+        x ^= t ^ (t << 14);
+        t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+        x ^= t ^ (t << 28);
+        for (size_t b = 0; b < 8; ++b)
+            symbols[g * 8 + b] = (x >> (56 - b * 8)) & 0x3f;
+    }
+}
+#endif
+
+static inline uint32_t sectorSize(CueParser::Track::Type type)
+{
+    switch (type) {
+    case CueParser::Track::Type::CDG:
+        return CDG::SectorSize;
+    case CueParser::Track::Type::Mode1_2048:
+    case CueParser::Track::Type::Mode2_2048:
+        return 2048;
+    case CueParser::Track::Type::Mode2_2324:
+        return 2324;
+    case CueParser::Track::Type::Mode2_2336:
+    case CueParser::Track::Type::CDI_2336:
+        return 2336;
+    default:
+        break;
+    }
+    return CDG::AudioSize;
+}
+
+static inline std::pair<uint64_t, bool> startFrame(const CueParser::Track& track)
+{
+    if (track.index.empty())
+        return std::make_pair(uint64_t { 0 }, false);
+    uint64_t frame = UINT64_MAX;
+    for (const auto& idx : track.index) {
+        const auto& l = idx.length;
+        frame = std::min<uint64_t>(frame, (l.mm * 60 + l.ss) * CDG::SectorsPerSecond + l.ff);
+    }
+    return std::make_pair(frame, true);
+}
+
+} // anonymous namespace
+
+namespace CDG {
+
+Decoder::Decoder(const Options& options)
+    : mOptions(options)
+{
+}
+
+void Decoder::reset()
+{
+    mStats = Stats { };
+    mRawPacks = 0;
+    mDelay = { };
+}
+
+size_t Decoder::decode(const uint8_t* subcode, size_t sectors, std::vector<Pack>& packs)
+{
+    // grow geometrically, callers commonly append a sector at a time
+    const size_t before = packs.size();
+    const size_t need = before + sectors * PacksPerSector;
+    if (packs.capacity() < need)
+        packs.reserve(std::max(need, packs.capacity() * 2));
+
+    uint8_t symbols[SubcodeSize];
+    for (size_t sector = 0; sector < sectors; ++sector, subcode += SubcodeSize) {
+        if (mOptions.layout == Layout::PerChannel)
+            extractPerChannel(subcode, symbols);
+        else
+            extractInterleaved(subcode, symbols);
+        for (size_t p = 0; p < PacksPerSector; ++p)
+            push(symbols + p * PackSize, packs);
+    }
+
+    return packs.size() - before;
+}
+
+void Decoder::push(const uint8_t* raw, std::vector<Pack>& packs)
+{
+    uint8_t symbols[PackSize];
+    if (mOptions.deinterleave) {
+        memcpy(mDelay[mRawPacks & 7].data(), raw, PackSize);
+        if (++mRawPacks < 8)
+            return;
+
+        // symbol n of a pack was delayed by n % 8 packs, which is byte n % 8 of
+        // each word, so the oldest pack is complete now
+        uint64_t words[3] = { };
+        for (size_t d = 0; d < 8; ++d) {
+            const auto& src = mDelay[(mRawPacks + d) & 7];
+            const auto mask = tables.delayMask[d];
+            words[0] |= src[0] & mask;
+            words[1] |= src[1] & mask;
+            words[2] |= src[2] & mask;
+        }
+        memcpy(symbols, words, PackSize);
+
+        std::swap(symbols[1], symbols[18]);
+        std::swap(symbols[2], symbols[5]);
+        std::swap(symbols[3], symbols[23]);
+    } else {
+        memcpy(symbols, raw, PackSize);
+    }
+
+    ++mStats.packs;
+    if (mOptions.correct) {
+        switch (correct(symbols)) {
+        case Result::Clean:
+            break;
+        case Result::Corrected:
+            ++mStats.corrected;
+            break;
+        case Result::Uncorrectable:
+            ++mStats.uncorrectable;
+            return;
+        }
+    }
+
+    packs.emplace_back();
+    memcpy(&packs.back(), symbols, PackSize);
+}
+
+Screen::Screen()
+{
+}
+
+void Screen::reset()
+{
+    mPixels = { };
+    mPalette = { };
+    mBorder = 0;
+    mTransparent = 0xff;
+    mHOffset = 0;
+    mVOffset = 0;
+}
+
+bool Screen::apply(const Pack& pack)
+{
+    if ((pack.command & 0x3f) != GraphicsCommand)
+        return false;
+
+    switch (static_cast<Instruction>(pack.instruction & 0x3f)) {
+    case Instruction::MemoryPreset:
+        return memoryPreset(pack);
+    case Instruction::BorderPreset:
+        return borderPreset(pack);
+    case Instruction::TileBlock:
+        return tileBlock(pack, false);
+    case Instruction::TileBlockXor:
+        return tileBlock(pack, true);
+    case Instruction::ScrollPreset:
+        return scroll(pack, false);
+    case Instruction::ScrollCopy:
+        return scroll(pack, true);
+    case Instruction::TransparentColor: {
+        const uint8_t transparent = pack.data[0] & 0x0f;
+        const bool changed = transparent != mTransparent;
+        mTransparent = transparent;
+        return changed;
+    }
+    case Instruction::LoadColorsLow:
+        return loadColors(pack, 0);
+    case Instruction::LoadColorsHigh:
+        return loadColors(pack, 8);
+    }
+    return false;
+}
+
+bool Screen::memoryPreset(const Pack& pack)
+{
+    // presets are sent repeatedly, only the first one normally changes anything
+    return fill(mPixels.data(), Width * Height, pack.data[0] & 0x0f);
+}
+
+bool Screen::borderPreset(const Pack& pack)
+{
+    const uint8_t color = pack.data[0] & 0x0f;
+    bool changed = color != mBorder;
+    mBorder = color;
+    changed |= fill(mPixels.data(), InnerTop * Width, color);
+    changed |= fill(mPixels.data() + InnerBottom * Width, (Height - InnerBottom) * Width, color);
+    for (uint32_t y = InnerTop; y < InnerBottom; ++y) {
+        uint8_t* row = mPixels.data() + y * Width;
+        changed |= fill(row, InnerLeft, color);
+        changed |= fill(row + InnerRight, Width - InnerRight, color);
+    }
+    return changed;
+}
+
+bool Screen::tileBlock(const Pack& pack, bool xorMode)
+{
+    const uint32_t row = pack.data[2] & 0x1f;
+    const uint32_t column = pack.data[3] & 0x3f;
+    if (row >= Rows || column >= Columns)
+        return false;
+
+    bool changed = false;
+
+    const uint64_t color0 = (pack.data[0] & 0x0f) * 0x0101010101010101ULL;
+    const uint64_t color1 = (pack.data[1] & 0x0f) * 0x0101010101010101ULL;
+    uint8_t* dst = mPixels.data() + row * TileHeight * Width + column * TileWidth;
+    for (uint32_t y = 0; y < TileHeight; ++y, dst += Width) {
+        const uint64_t mask = tables.tileMask[pack.data[4 + y] & 0x3f];
+        uint64_t line = (color1 & mask) | (color0 & ~mask);
+        uint64_t cur = 0;
+        memcpy(&cur, dst, TileWidth);
+        if (xorMode)
+            line ^= cur;
+        // only the first TileWidth bytes are pixels, the rest of line is padding
+        changed |= memcmp(dst, &line, TileWidth) != 0;
+        memcpy(dst, &line, TileWidth);
+    }
+    return changed;
+}
+
+bool Screen::scroll(const Pack& pack, bool copy)
+{
+    const uint8_t color = pack.data[0] & 0x0f;
+    const uint8_t h = pack.data[1] & 0x3f;
+    const uint8_t v = pack.data[2] & 0x3f;
+    const bool moved = (h & 0x07) != mHOffset || (v & 0x0f) != mVOffset;
+    mHOffset = h & 0x07;
+    mVOffset = v & 0x0f;
+
+    // 1 moves the picture right or down by a tile, 2 left or up
+    int dx = 0, dy = 0;
+    if ((h >> 4) == 1)
+        dx = TileWidth;
+    else if ((h >> 4) == 2)
+        dx = -TileWidth;
+    if ((v >> 4) == 1)
+        dy = TileHeight;
+    else if ((v >> 4) == 2)
+        dy = -TileHeight;
+    if (!dx && !dy)
+        return moved;
+
+    const auto old = mPixels;
+    const int shift = dx > 0 ? dx : -dx;
+    for (int y = 0; y < Height; ++y) {
+        uint8_t* dst = mPixels.data() + y * Width;
+        const int sy = y - dy;
+        if ((sy < 0 || sy >= Height) && !copy) {
+            memset(dst, color, Width);
+            continue;
+        }
+        const uint8_t* src = old.data() + ((sy + Height) % Height) * Width;
+        // the columns that move in from the other side are either wrapped or filled
+        if (dx > 0) {
+            memcpy(dst + shift, src, Width - shift);
+            if (copy)
+                memcpy(dst, src + Width - shift, shift);
+            else
+                memset(dst, color, shift);
+        } else {
+            memcpy(dst, src + shift, Width - shift);
+            if (copy)
+                memcpy(dst + Width - shift, src, shift);
+            else
+                memset(dst + Width - shift, color, shift);
+        }
+    }
+    return moved || mPixels != old;
+}
+
+bool Screen::loadColors(const Pack& pack, uint32_t offset)
+{
+    bool changed = false;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const uint8_t hi = pack.data[i * 2] & 0x3f;
+        const uint8_t lo = pack.data[i * 2 + 1] & 0x3f;
+        const uint16_t r = (hi >> 2) & 0x0f;
+        const uint16_t g = ((hi & 0x03) << 2) | ((lo >> 4) & 0x03);
+        const uint16_t b = lo & 0x0f;
+        const uint16_t color = (r << 8) | (g << 4) | b;
+        changed |= mPalette[offset + i] != color;
+        mPalette[offset + i] = color;
+    }
+    return changed;
+}
+
+void Screen::render(uint32_t* pixels) const
+{
+    uint32_t colors[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        const uint32_t c = mPalette[i];
+        colors[i] = (i == mTransparent ? 0x00000000 : 0xff000000)
+            | (((c >> 8) & 0x0f) * 0x11) << 16
+            | (((c >> 4) & 0x0f) * 0x11) << 8
+            | ((c & 0x0f) * 0x11);
+    }
+
+    const uint32_t border = colors[mBorder];
+    std::fill(pixels, pixels + InnerTop * Width, border);
+    std::fill(pixels + InnerBottom * Width, pixels + Height * Width, border);
+    for (uint32_t y = InnerTop; y < InnerBottom; ++y) {
+        uint32_t* dst = pixels + y * Width;
+        std::fill(dst, dst + InnerLeft, border);
+        std::fill(dst + InnerRight, dst + Width, border);
+        // the offsets pan the visible area over the pixel memory
+        const uint8_t* src = mPixels.data() + std::min<uint32_t>(y + mVOffset, Height - 1) * Width;
+        for (uint32_t x = InnerLeft; x < InnerRight; ++x)
+            dst[x] = colors[src[std::min<uint32_t>(x + mHOffset, Width - 1)]];
+    }
+}
+
+std::vector<TrackData> tracks(const CueParser::CueSheet& sheet, const fs::path& cueFile)
+{
+    std::vector<TrackData> out;
+
+    for (const auto& file : sheet.files) {
+        if (file.type != CueParser::File::Type::Binary)
+            continue;
+        const auto hasCdg = std::any_of(file.tracks.begin(), file.tracks.end(), [](const auto& track) {
+            return track.type == CueParser::Track::Type::CDG;
+        });
+        if (!hasCdg)
+            continue;
+
+        fs::path filename = file.filename;
+        if (filename.is_relative())
+            filename = cueFile.parent_path() / filename;
+        std::error_code ec;
+        const auto size = fs::file_size(filename, ec);
+        if (ec)
+            continue;
+
+        // INDEX positions are in frames from the start of the file, the
+        // byte offset depends on the sector size of every track before
+        uint64_t offset = 0;
+        uint64_t prevFrame = 0;
+        uint32_t prevSize = 0;
+        for (size_t t = 0; t < file.tracks.size(); ++t) {
+            const auto& track = file.tracks[t];
+            const auto [ frame, frameok ] = startFrame(track);
+            if (!frameok)
+                continue;
+            if (!prevSize)
+                prevSize = sectorSize(track.type);
+            offset += (frame - std::min(frame, prevFrame)) * prevSize;
+            prevFrame = frame;
+            prevSize = sectorSize(track.type);
+
+            if (track.type != CueParser::Track::Type::CDG)
+                continue;
+
+            uint64_t sectors = 0;
+            for (size_t n = t + 1; n < file.tracks.size(); ++n) {
+                const auto [ next, nextok ] = startFrame(file.tracks[n]);
+                if (nextok) {
+                    sectors = next - std::min(next, frame);
+                    break;
+                }
+            }
+            if (!sectors && offset < size)
+                sectors = (size - offset) / SectorSize;
+            if (offset + sectors * SectorSize > size)
+                sectors = offset < size ? (size - offset) / SectorSize : 0;
+
+            out.push_back(TrackData { filename, track.number, offset, sectors });
+        }
+    }
+
+    return out;
+}
+
+Reader::Reader(const TrackData& track)
+    : mTrack(track), mFile(track.filename, std::ios::in | std::ios::binary)
+{
+    seek(0);
+}
+
+bool Reader::seek(uint64_t sector)
+{
+    if (!mFile.is_open() || sector > mTrack.sectors)
+        return false;
+    mFile.clear();
+    mFile.seekg(mTrack.offset + sector * SectorSize);
+    if (!mFile)
+        return false;
+    mSector = sector;
+    return true;
+}
+
+size_t Reader::read(uint8_t* subcode, size_t sectors)
+{
+    if (!mFile.is_open())
+        return 0;
+
+    mBuffer.resize(ChunkSectors * SectorSize);
+
+    size_t done = 0;
+    while (done < sectors) {
+        const auto want = std::min<uint64_t>({ sectors - done, ChunkSectors, mTrack.sectors - mSector });
+        if (!want)
+            break;
+        mFile.read(mBuffer.data(), want * SectorSize);
+        const auto got = static_cast<size_t>(mFile.gcount()) / SectorSize;
+        for (size_t s = 0; s < got; ++s)
+            memcpy(subcode + (done + s) * SubcodeSize, mBuffer.data() + s * SectorSize + AudioSize, SubcodeSize);
+        done += got;
+        mSector += got;
+        if (got < want)
+            break;
+    }
+
+    return done;
+}
+
+void computeParity(Pack& pack)
+{
+    auto symbols = reinterpret_cast<uint8_t*>(&pack);
+    for (size_t i = 0; i < PackSize; ++i)
+        symbols[i] &= 0x3f;
+    encode(symbols, 4, tables.genQ, ParityQ);
+    encode(symbols, PackSize, tables.genP, ParityP);
+}
+
+} // namespace CDG
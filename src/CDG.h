@@ -0,0 +1,167 @@
+#pragma once
+
+#include "CueParser.h"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace CDG {
+
+enum {
+    SectorSize = 2448,
+    AudioSize = 2352,
+    SubcodeSize = 96,
+    PackSize = 24,
+    PacksPerSector = 4,
+    SectorsPerSecond = 75,
+    GraphicsCommand = 0x09
+};
+
+// One R-W subcode pack, 24 six-bit symbols
+struct Pack
+{
+    uint8_t command;
+    uint8_t instruction;
+    uint8_t parityQ[2];
+    uint8_t data[16];
+    uint8_t parityP[4];
+};
+
+static_assert(sizeof(Pack) == PackSize);
+
+enum class Instruction : uint8_t {
+    MemoryPreset = 1,
+    BorderPreset = 2,
+    TileBlock = 6,
+    ScrollPreset = 20,
+    ScrollCopy = 24,
+    TransparentColor = 28,
+    LoadColorsLow = 30,
+    LoadColorsHigh = 31,
+    TileBlockXor = 38
+};
+
+// R-W data that is already deinterleaved and corrected (cdrdao's rw as opposed
+// to rw_raw) is Interleaved with deinterleave and correct turned off
+enum class Layout {
+    Interleaved, // one byte per symbol, channels P-W in bits 7-0
+    PerChannel   // 12 bytes per channel, P first, like CloneCD .sub files
+};
+
+struct Options
+{
+    Layout layout { Layout::Interleaved };
+    bool deinterleave { true }; // undo the pack delay and symbol scramble, for raw subcode
+    bool correct { true };      // apply Q and P parity, packs that can't be corrected are dropped
+};
+
+struct Stats
+{
+    uint64_t packs { 0 };
+    uint64_t corrected { 0 };
+    uint64_t uncorrectable { 0 };
+};
+
+class Decoder
+{
+public:
+    Decoder(const Options& options = Options { });
+
+    // decodes SubcodeSize bytes per sector, appends the resulting packs and returns how many were added.
+    // with deinterleave enabled, output lags the input by seven packs.
+    size_t decode(const uint8_t* subcode, size_t sectors, std::vector<Pack>& packs);
+    void reset();
+
+    const Options& options() const { return mOptions; }
+    const Stats& stats() const { return mStats; }
+
+private:
+    void push(const uint8_t* raw, std::vector<Pack>& packs);
+
+    Options mOptions;
+    Stats mStats { };
+
+    uint64_t mRawPacks { 0 };
+    std::array<std::array<uint64_t, 3>, 8> mDelay { };
+};
+
+class Screen
+{
+public:
+    enum {
+        Width = 300,
+        Height = 216,
+        TileWidth = 6,
+        TileHeight = 12,
+        Columns = 50,
+        Rows = 18
+    };
+
+    Screen();
+
+    // returns true if the pack changed the pixels, palette, border, transparent
+    // color or scroll offsets, i.e. the state render() draws from
+    bool apply(const Pack& pack);
+    void reset();
+
+    // writes Width * Height 0xAARRGGBB pixels, the transparent color gets alpha 0
+    void render(uint32_t* pixels) const;
+
+    uint8_t pixel(uint32_t x, uint32_t y) const { return mPixels[y * Width + x]; }
+    const std::array<uint16_t, 16>& palette() const { return mPalette; }
+    uint8_t border() const { return mBorder; }
+
+private:
+    bool memoryPreset(const Pack& pack);
+    bool borderPreset(const Pack& pack);
+    bool tileBlock(const Pack& pack, bool xorMode);
+    bool scroll(const Pack& pack, bool copy);
+    bool loadColors(const Pack& pack, uint32_t offset);
+
+    std::array<uint8_t, Width * Height> mPixels { };
+    std::array<uint16_t, 16> mPalette { };
+    uint8_t mBorder { 0 };
+    uint8_t mTransparent { 0xff };
+    uint8_t mHOffset { 0 };
+    uint8_t mVOffset { 0 };
+};
+
+// location of a CDG track inside its binary file
+struct TrackData
+{
+    std::filesystem::path filename { };
+    uint32_t number { 0 };
+    uint64_t offset { 0 };
+    uint64_t sectors { 0 };
+};
+
+std::vector<TrackData> tracks(const CueParser::CueSheet& sheet, const std::filesystem::path& cueFile);
+
+class Reader
+{
+public:
+    Reader(const TrackData& track);
+
+    bool isOpen() const { return mFile.is_open(); }
+    uint64_t sector() const { return mSector; }
+    uint64_t sectors() const { return mTrack.sectors; }
+
+    bool seek(uint64_t sector);
+    // reads the subcode of up to sectors sectors, SubcodeSize bytes each
+    size_t read(uint8_t* subcode, size_t sectors);
+
+private:
+    enum { ChunkSectors = 64 };
+
+    TrackData mTrack;
+    std::ifstream mFile;
+    uint64_t mSector { 0 };
+    std::vector<char> mBuffer;
+};
+
+// fills in parityQ and parityP from the other symbols
+void computeParity(Pack& pack);
+
+} // namespace CDG
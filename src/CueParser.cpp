@@ -1,4 +1,5 @@
 #include "CueParser.h"
+#include <algorithm>
 #include <array>
 #include <cctype>
 #include <cstdlib>